@@ -0,0 +1,365 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * 2048-bench.cpp: Scaling benchmark of evaluation, training, and search over threads
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "resource.h"
+
+/**
+ * counters of a benchmark run
+ *  items: games (eval, train) or positions (search) finished
+ *  units: games (eval), updates (train), or nodes (search)
+ *  evals: afterstate evaluations, each of which reads 8 entries of each of the 4 tables
+ */
+struct counter {
+	uint64_t items = 0;
+	uint64_t units = 0;
+	uint64_t evals = 0;
+};
+
+struct config {
+	std::string workload;
+	unsigned threads;
+	unsigned batch;
+	unsigned interleave;
+};
+
+struct result {
+	config conf;
+	counter count;
+	double seconds;
+	double rate() const { return count.units / seconds; }
+	double traffic(double bytes) const { return count.evals * bytes / seconds / 1e9; } // estimated GB/s, 'bytes' per evaluation
+};
+
+/**
+ * pin the calling thread to the i-th CPU of the affinity mask
+ */
+void pin_thread(unsigned i) {
+	cpu_set_t mask;
+	if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return;
+	std::vector<int> cpus;
+	for (int c = 0; c < CPU_SETSIZE; c++) if (CPU_ISSET(c, &mask)) cpus.push_back(c);
+	if (cpus.empty()) return;
+	CPU_ZERO(&mask);
+	CPU_SET(cpus[i % cpus.size()], &mask);
+	pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+}
+
+/**
+ * measure the read bandwidth (GB/s) of pinned threads streaming over a buffer of 'bytes'
+ * each thread starts at a different offset, so that they do not read the same lines at once
+ */
+double stream_bandwidth(size_t bytes, unsigned threads) {
+	std::vector<uint64_t> buffer(std::max<size_t>(bytes / sizeof(uint64_t), 1), 1);
+	size_t n = buffer.size(), passes = std::max<size_t>((256 << 20) / bytes, 1);
+	std::atomic<uint64_t> sink(0);
+	std::vector<std::thread> pool;
+	auto begin = std::chrono::steady_clock::now();
+	for (unsigned t = 0; t < threads; t++) {
+		pool.emplace_back([&, t]() {
+			pin_thread(t);
+			uint64_t sum = 0;
+			for (size_t pass = 0, first = n / threads * t; pass < passes; pass++) {
+				for (size_t i = first; i < n; i++) sum += buffer[i];
+				for (size_t i = 0; i < first; i++) sum += buffer[i];
+			}
+			sink += sum;
+		});
+	}
+	for (std::thread& th : pool) th.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+	return double(n) * sizeof(uint64_t) * passes * threads / elapsed.count() / 1e9;
+}
+
+int legal_moves(const board& b) {
+	int n = 0;
+	for (int op : {0, 1, 2, 3}) n += (board(b).slide(op) != -1);
+	return n;
+}
+
+/**
+ * depth-limited expectimax over afterstates, counting the visited nodes
+ */
+float maximize(player& play, const board& before, unsigned depth, counter& count);
+float expect(player& play, const board& after, unsigned depth, counter& count) {
+	count.units++;
+	if (depth == 0) return count.evals++, play.estimate_value(after);
+	float sum = 0;
+	int empty = 0;
+	for (int pos = 0; pos < 16; pos++) {
+		if (after(pos) != 0) continue;
+		board two = after, four = after;
+		two.place(pos, 1);
+		four.place(pos, 2);
+		sum += 0.9f * maximize(play, two, depth - 1, count) + 0.1f * maximize(play, four, depth - 1, count);
+		empty++;
+	}
+	return empty ? sum / empty : (count.evals++, play.estimate_value(after));
+}
+float maximize(player& play, const board& before, unsigned depth, counter& count) {
+	count.units++;
+	float best = 0;
+	for (int op : {0, 1, 2, 3}) {
+		board after = before;
+		int reward = after.slide(op);
+		if (reward == -1) continue;
+		best = std::max(best, reward + expect(play, after, depth, count));
+	}
+	return best;
+}
+
+/**
+ * a game in progress on a worker, several of them are interleaved move by move
+ */
+struct slot {
+	std::unique_ptr<player> play;
+	std::unique_ptr<rndenv> evil;
+	board state;
+	size_t moves;
+	bool live;
+};
+
+/**
+ * the worker of a thread, which claims 'batch' items at a time from the shared counter
+ * the counts are kept locally and stored to 'total' at the end, so that the counters
+ * of different threads do not share a cache line while running
+ */
+void run_worker(const config& conf, player& master, const std::string& alpha, size_t items, uint64_t seed,
+		std::atomic<size_t>& next, unsigned id, counter& total) {
+	pin_thread(id);
+	counter count;
+	std::deque<size_t> pending;
+	auto claim = [&](size_t& item) {
+		if (pending.empty()) {
+			size_t first = next.fetch_add(conf.batch);
+			for (size_t i = first; i < std::min<size_t>(first + conf.batch, items); i++) pending.push_back(i);
+		}
+		if (pending.empty()) return false;
+		item = pending.front();
+		pending.pop_front();
+		return true;
+	};
+
+	std::vector<slot> games(conf.workload == "search" ? 1 : conf.interleave);
+	for (slot& s : games) {
+		s.play.reset(new player(alpha));
+		s.play->share(master);
+		s.evil.reset(new rndenv());
+		s.live = false;
+	}
+	auto start = [&](slot& s, size_t item) {
+		s.evil->notify("seed=" + std::to_string(episode_seed(seed, item)));
+		s.play->open_episode();
+		s.state = board();
+		s.evil->take_action(s.state).apply(s.state);
+		s.evil->take_action(s.state).apply(s.state);
+		s.moves = 0;
+		s.live = true;
+	};
+
+	if (conf.workload == "search") {
+		slot& s = games[0];
+		for (size_t item; claim(item); ) {
+			start(s, item);
+			for (int i = 0; i < 20 && s.live; i++) { // reach a mid-game position with the greedy player
+				s.live = s.play->take_action(s.state).apply(s.state) != -1;
+				if (s.live) s.evil->take_action(s.state).apply(s.state);
+			}
+			maximize(*s.play, s.state, 2, count);
+			count.items++;
+		}
+		total = count;
+		return;
+	}
+
+	for (slot& s : games) {
+		size_t item;
+		if (claim(item)) start(s, item);
+	}
+	for (size_t live = games.size(); live; ) {
+		live = 0;
+		for (slot& s : games) {
+			if (!s.live) continue;
+			live++;
+			count.evals += legal_moves(s.state);
+			if (s.play->take_action(s.state).apply(s.state) != -1) {
+				s.evil->take_action(s.state).apply(s.state);
+				s.moves++;
+				continue;
+			}
+			s.play->close_episode();
+			count.items++;
+			count.units += conf.workload == "train" ? s.moves : 1;
+			if (conf.workload == "train") count.evals += s.moves * 3; // the target, the error, and the update
+			size_t item;
+			s.live = false;
+			if (claim(item)) start(s, item);
+		}
+	}
+	total = count;
+}
+
+/**
+ * run a workload on the shared tables of the master
+ * training updates a copy of the master from all threads without locks (Hogwild-style),
+ * so the updates of different threads may race and the trained values are not reproducible
+ */
+result run(const config& conf, player& master, size_t items, uint64_t seed) {
+	std::string alpha = conf.workload == "train" ? "alpha=0.0025" : "alpha=0";
+	player trainee;
+	if (conf.workload == "train") trainee.clone(master); // keep the master intact for the other runs
+	player& tables = conf.workload == "train" ? trainee : master;
+	std::vector<counter> counts(conf.threads);
+	std::vector<std::thread> pool;
+	std::atomic<size_t> next(0);
+	auto begin = std::chrono::steady_clock::now();
+	for (unsigned t = 0; t < conf.threads; t++)
+		pool.emplace_back(run_worker, std::cref(conf), std::ref(tables), alpha, items, seed, std::ref(next), t, std::ref(counts[t]));
+	for (std::thread& th : pool) th.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+	result res = { conf, {}, elapsed.count() };
+	for (const counter& c : counts) {
+		res.count.items += c.items;
+		res.count.units += c.units;
+		res.count.evals += c.evals;
+	}
+	return res;
+}
+
+std::vector<unsigned> parse_list(const std::string& list) {
+	std::vector<unsigned> res;
+	std::stringstream ss(list);
+	for (std::string v; std::getline(ss, v, ','); ) if (v.size()) res.push_back(std::stoul(v));
+	return res;
+}
+
+int main(int argc, const char* argv[]) {
+	std::cout << "2048-Bench: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
+	std::cout << std::endl << std::endl;
+
+	resource res;
+	std::string play_args = "init", csv = "bench.csv";
+	std::vector<std::string> workloads = { "eval", "train", "search" };
+	std::vector<unsigned> threads, batches = { 1, 16 }, interleaves = { 1, 4 };
+	size_t items = 200;
+	uint64_t seed = 1;
+	for (unsigned t = 1; t < res.threads(); t *= 2) threads.push_back(t);
+	threads.push_back(res.threads());
+	for (int i = 1; i < argc; i++) {
+		std::string para(argv[i]);
+		if (para.find("--play=") == 0) {
+			play_args = para.substr(para.find("=") + 1);
+		} else if (para.find("--threads=") == 0) {
+			threads = parse_list(para.substr(para.find("=") + 1));
+		} else if (para.find("--batch=") == 0) {
+			batches = parse_list(para.substr(para.find("=") + 1));
+		} else if (para.find("--interleave=") == 0) {
+			interleaves = parse_list(para.substr(para.find("=") + 1));
+		} else if (para.find("--items=") == 0) {
+			items = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--seed=") == 0) {
+			seed = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--workload=") == 0) {
+			std::stringstream ss(para.substr(para.find("=") + 1));
+			workloads.clear();
+			for (std::string w; std::getline(ss, w, ','); ) workloads.push_back(w);
+		} else if (para.find("--csv=") == 0) {
+			csv = para.substr(para.find("=") + 1);
+		}
+	}
+	std::cout << "resource: " << res << std::endl;
+
+	player master(play_args);
+	// each evaluation reads 8 entries of each table, a cache line from the memory for each entry
+	// of the tables larger than the last-level cache, while the smaller tables stay in the cache
+	double bytes = master.tables(res.cache) * 8 * 64.0;
+	std::map<unsigned, double> bandwidth;
+	std::cout << "stream:";
+	for (unsigned t : threads) {
+		bandwidth[t] = stream_bandwidth(master.footprint(), t);
+		std::cout << " " << t << " threads = " << std::fixed << std::setprecision(2) << bandwidth[t] << " GB/s,";
+	}
+	std::cout << " over " << (master.footprint() >> 20) << "M like the tables" << std::endl << std::endl;
+
+	std::ofstream out(csv, std::ios::out | std::ios::trunc);
+	out << "workload,threads,batch,interleave,items,units,seconds,rate,efficiency,traffic_estimate,stream_bandwidth" << std::endl;
+	std::cout << std::left << std::setw(8) << "workload" << std::right << std::setw(8) << "threads";
+	std::cout << std::setw(7) << "batch" << std::setw(11) << "interleave" << std::setw(14) << "rate";
+	std::cout << std::setw(12) << "efficiency" << std::setw(10) << "~GB/s" << std::setw(10) << "stream" << std::endl;
+
+	for (const std::string& workload : workloads) {
+		std::string unit = workload == "search" ? "nodes/s" : workload == "train" ? "updates/s" : "games/s";
+		for (unsigned batch : batches) {
+			for (unsigned interleave : interleaves) {
+				if (workload == "search" && interleave != interleaves.front()) continue; // search is not interleaved
+				if (workload == "search") interleave = 1;
+				std::vector<result> curve;
+				for (unsigned t : threads) {
+					result r = run({ workload, t, batch, interleave }, master, items, seed);
+					double base = curve.size() ? curve.front().rate() / curve.front().conf.threads : r.rate() / t;
+					double efficiency = r.rate() / (base * t);
+					curve.push_back(r);
+
+					std::cout << std::fixed << std::setprecision(2);
+					std::cout << std::left << std::setw(8) << workload << std::right << std::setw(8) << t;
+					std::cout << std::setw(7) << batch << std::setw(11) << interleave;
+					std::cout << std::setw(14) << std::setprecision(0) << r.rate();
+					std::cout << std::setw(12) << std::setprecision(2) << efficiency;
+					std::cout << std::setw(10) << r.traffic(bytes) << std::setw(10) << bandwidth[t] << std::endl;
+					out << workload << ',' << t << ',' << batch << ',' << interleave << ',' << r.count.items << ',';
+					out << r.count.units << ',' << r.seconds << ',' << r.rate() << ',' << efficiency << ',';
+					out << r.traffic(bytes) << ',' << bandwidth[t] << std::endl;
+				}
+
+				// the knee is the last thread count keeping 80% of the linear speedup, which is only
+				// searched within the physical cores, since more threads just oversubscribe them;
+				// it is blamed on the memory only if the estimated table traffic beyond the knee
+				// reaches half of the streaming bandwidth measured with as many threads
+				size_t within = 0, knee = 0;
+				while (within < curve.size() && curve[within].conf.threads <= res.cores) within++;
+				double base = curve.front().rate() / curve.front().conf.threads;
+				while (knee + 1 < within && curve[knee + 1].rate() >= 0.8 * base * curve[knee + 1].conf.threads) knee++;
+				std::cout << "\t" << workload << " (" << unit << ")";
+				if (within == 0) {
+					std::cout << " has no sweep point within the " << res.cores << " cores";
+				} else if (knee + 1 < within) {
+					const result& past = curve[knee + 1];
+					double traffic = past.traffic(bytes), limit = bandwidth[past.conf.threads];
+					std::cout << " stops scaling after " << curve[knee].conf.threads << " threads, ";
+					std::cout << (traffic >= 0.5 * limit ? "saturating" : "not bound by") << " the memory (~";
+					std::cout << traffic << " GB/s of estimated table traffic, " << limit << " GB/s streaming)";
+				} else {
+					std::cout << " scales up to " << curve[knee].conf.threads << " threads, no knee within the ";
+					std::cout << res.cores << " cores";
+				}
+				std::cout << std::endl << std::endl;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * 2048-peer.cpp: Reference peer serving an agent to another process through shared memory
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "ipc.h"
+
+int main(int argc, const char* argv[]) {
+	std::cout << "2048-Peer: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
+	std::cout << std::endl << std::endl;
+
+	std::string shm = "/tcg2584", evil_args;
+	for (int i = 1; i < argc; i++) {
+		std::string para(argv[i]);
+		if (para.find("--shm=") == 0) {
+			shm = para.substr(para.find("=") + 1);
+		} else if (para.find("--evil=") == 0) {
+			evil_args = para.substr(para.find("=") + 1);
+		}
+	}
+
+	rndenv evil(evil_args);
+	channel link(shm, true);
+
+	size_t served = 0;
+	for (bool serving = true; serving; ) {
+		channel::message msg = link.recv();
+		switch (msg.type) {
+		case channel::open:
+			evil.open_episode(msg.text);
+			break;
+		case channel::close:
+			evil.close_episode(msg.text);
+			break;
+		case channel::take:
+			link.send(channel::message(channel::reply, evil.take_action(msg.unpack())));
+			served++;
+			break;
+		case channel::check:
+			link.send(channel::message(channel::reply, evil.check_for_win(msg.unpack())));
+			break;
+		case channel::notify:
+			evil.notify(msg.text);
+			break;
+		case channel::quit:
+		default:
+			serving = false;
+			break;
+		}
+	}
+
+	std::cout << evil.name() << ": " << served << " actions served" << std::endl;
+	return 0;
+}
@@ -11,11 +11,38 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <memory>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistic.h"
+#include "codec.h"
+#include "ipc.h"
+#include "campaign.h"
+#include "resource.h"
+
+/**
+ * play an episode between the player and the environment, and record it
+ */
+void play_episode(statistic& stat, agent& play, agent& evil) {
+	play.open_episode("~:" + evil.name());
+	evil.open_episode(play.name() + ":~");
+
+	stat.open_episode(play.name() + ":" + evil.name());
+	episode& game = stat.back();
+	while (true) {
+		agent& who = game.take_turns(play, evil);
+		action move = who.take_action(game.state());
+		if (game.apply_action(move) != true) break;
+		if (who.check_for_win(game.state())) break;
+	}
+	agent& win = game.last_turns(play, evil);
+	stat.close_episode(win.name());
+
+	play.close_episode(win.name());
+	evil.close_episode(win.name());
+}
 
 int main(int argc, const char* argv[]) {
 	std::cout << "2048-Demo: ";
@@ -25,7 +52,13 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string play_args, evil_args;
 	std::string load, save;
-	bool summary = false;
+	bool summary = false, compress = false;
+	std::string queue;
+	size_t range = 1000;
+	unsigned lease = 600;
+	bool finalize = false;
+	unsigned threads = 0;
+	bool autoconf = false;
 	for (int i = 1; i < argc; i++) {
 		std::string para(argv[i]);
 		if (para.find("--total=") == 0) {
@@ -44,38 +77,93 @@ int main(int argc, const char* argv[]) {
 			save = para.substr(para.find("=") + 1);
 		} else if (para.find("--summary") == 0) {
 			summary = true;
+		} else if (para.find("--compress") == 0) {
+			compress = true;
+		} else if (para.find("--campaign=") == 0) {
+			queue = para.substr(para.find("=") + 1);
+		} else if (para.find("--range=") == 0) {
+			range = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--lease=") == 0) {
+			lease = std::stoul(para.substr(para.find("=") + 1));
+		} else if (para.find("--finalize") == 0) {
+			finalize = true;
+		} else if (para.find("--threads=") == 0) {
+			threads = std::stoul(para.substr(para.find("=") + 1));
+		} else if (para.find("--auto") == 0) {
+			autoconf = true;
 		}
 	}
 
+	player play(play_args);
+	std::unique_ptr<agent> env(evil_args.find("shm=") != std::string::npos ?
+		static_cast<agent*>(new shm_agent(evil_args)) : new rndenv(evil_args));
+	agent& evil = *env;
+
+	if (autoconf) {
+		resource res;
+		plan conf(res, total, episode::footprint(), play.footprint());
+		if (limit) conf.limit = limit; else limit = std::max(conf.limit, block);
+		if (threads) conf.threads = threads; else threads = conf.threads;
+		if (play_args.find("hugepage") != std::string::npos) conf.hugepage = false; // decided by the player
+		if (conf.hugepage) play.advise_hugepage();
+		std::cout << "resource: " << res << std::endl;
+		std::cout << "plan: " << conf << std::endl << std::endl;
+	}
+
 	statistic stat(total, block, limit);
 
 	if (load.size()) {
-		std::ifstream in(load, std::ios::in);
+		std::ifstream file(load, std::ios::in | std::ios::binary);
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		if (codec::is_packed(data)) data = codec::decompress(data);
+		std::stringstream in(data);
 		in >> stat;
-		in.close();
 		summary |= stat.is_finished();
 	}
 
-	player play(play_args);
-	rndenv evil(evil_args);
-
-	while (!stat.is_finished()) {
-		play.open_episode("~:" + evil.name());
-		evil.open_episode(play.name() + ":~");
-
-		stat.open_episode(play.name() + ":" + evil.name());
-		episode& game = stat.back();
-		while (true) {
-			agent& who = game.take_turns(play, evil);
-			action move = who.take_action(game.state());
-			if (game.apply_action(move) != true) break;
-			if (who.check_for_win(game.state())) break;
+	if (queue.size() && !finalize) {
+		campaign work(queue, lease);
+		if (work.create(total, range)) std::cout << "campaign: created " << queue << std::endl;
+		if (size_t lost = work.requeue()) std::cout << "campaign: requeued " << lost << " ranges" << std::endl;
+		uint64_t base = 0;
+		if (evil_args.find("seed=") != std::string::npos)
+			std::stringstream(evil_args.substr(evil_args.find("seed=") + 5)) >> base;
+		auto claim = [&](size_t& first, size_t& last) { // also pick up the ranges of workers crashed meanwhile
+			if (work.claim(first, last)) return true;
+			size_t lost = work.requeue();
+			if (lost) std::cout << "campaign: requeued " << lost << " ranges" << std::endl;
+			return lost && work.claim(first, last);
+		};
+		for (size_t first, last; claim(first, last); ) {
+			statistic part(last - first, block, 0);
+			for (size_t i = first; i < last; i++) {
+				evil.notify("seed=" + std::to_string(episode_seed(base, i)));
+				play_episode(part, play, evil);
+				work.renew(first, last);
+			}
+			std::stringstream out;
+			out << part;
+			work.complete(first, last, codec::compress(out.str(), 1, 1 << 20, threads));
+			std::cout << "campaign: episodes " << first << "-" << last << " done" << std::endl;
 		}
-		agent& win = game.last_turns(play, evil);
-		stat.close_episode(win.name());
+		summary = false; // the played ranges are merged by --finalize instead
 
-		play.close_episode(win.name());
-		evil.close_episode(win.name());
+	} else if (queue.size()) {
+		campaign work(queue);
+		std::vector<std::string> results = work.results();
+		for (const std::string& result : results) {
+			std::stringstream in(codec::is_packed(result) ? codec::decompress(result) : result);
+			in >> stat;
+		}
+		std::cout << "campaign: " << results.size() << " ranges done, " << work.running() << " running, ";
+		std::cout << work.pending() << " pending" << std::endl << std::endl;
+		summary = results.size();
+
+	} else {
+		while (!stat.is_finished()) {
+			play_episode(stat, play, evil);
+		}
 	}
 
 	if (summary) {
@@ -83,9 +171,14 @@ int main(int argc, const char* argv[]) {
 	}
 
 	if (save.size()) {
-		std::ofstream out(save, std::ios::out | std::ios::trunc);
+		std::ofstream file(save, std::ios::out | std::ios::binary | std::ios::trunc);
+		std::stringstream out;
 		out << stat;
-		out.close();
+		if (compress)
+			file << codec::compress(out.str(), 1, 1 << 20, threads);
+		else
+			file << out.rdbuf();
+		file.close();
 	}
 
 	return 0;
@@ -17,7 +17,14 @@
 #include "board.h"
 #include "action.h"
 #include "weight.h"
+#include "codec.h"
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sys/stat.h>
 
 class agent {
 public:
@@ -63,28 +70,110 @@ public:
 	}
 	virtual ~random_agent() {}
 
+	virtual void notify(const std::string& msg) {
+		agent::notify(msg);
+		if (msg.find("seed=") == 0)
+			engine.seed(int(meta["seed"]));
+	}
+
 protected:
 	std::default_random_engine engine;
 };
 
+/**
+ * counter-based seed of the i-th episode (splitmix64), so that an episode
+ * is reproducible no matter which worker or thread plays it
+ */
+inline int episode_seed(uint64_t base, uint64_t i) {
+	uint64_t z = base + (i + 1) * 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return int((z ^ (z >> 31)) & 0x7fffffff);
+}
+
+/**
+ * the weight file linked into the binary by 'make embed'
+ * both symbols are null if the binary is built without an embedded model
+ */
+extern "C" const char embedded_weights_begin[] __attribute__((weak));
+extern "C" const char embedded_weights_end[] __attribute__((weak));
+
 /**
  * base agent for agents with weight tables and a learning rate
  */
 class player : public agent {
 public:
-	player(const std::string& args = "") : agent("name=dummy role=player " + args), alpha(0) {
+	player(const std::string& args = "") : agent("name=dummy role=player " + args), alpha(0),
+		version(0), pinned_version(0), stopped(false), reload_time(0), queries(0), query_time(0), query_max(0) {
 		if (meta.find("init") != meta.end())
 			init_weights(meta["init"]);
 		if (meta.find("load") != meta.end())
 			load_weights(meta["load"]);
+		if (meta.find("embed") != meta.end())
+			embed_weights();
 		if (meta.find("alpha") != meta.end())
 			alpha = float(meta["alpha"]);
+		if (meta.find("embed") != meta.end() && alpha != 0) std::exit(-1); // the embedded model is read-only
+		if (meta.find("reload") != meta.end() && alpha != 0) std::exit(-1); // the updates would be lost at the next reload
+		if (meta.find("hugepage") != meta.end() && std::string(meta["hugepage"]) != "off")
+			advise_hugepage();
+		if (meta.find("reload") != meta.end()) {
+			bool watch_load = std::string(meta["reload"]) == "reload";
+			if (watch_load && meta.find("load") == meta.end()) std::exit(-1); // no file to watch
+			start_reload(watch_load ? meta["load"] : meta["reload"]);
+		}
 	}
 	virtual ~player() {
+		if (watcher.joinable()) {
+			stopped = true;
+			watcher.join();
+		}
 		if (meta.find("save") != meta.end())
 			save_weights(meta["save"]);
 	}
 
+	/**
+	 * the memory footprint of the weight tables in bytes
+	 */
+	size_t footprint() const {
+		size_t bytes = 0;
+		for (const weight& w : net) bytes += w.size() * sizeof(weight::type);
+		return bytes;
+	}
+
+	/**
+	 * the number of weight tables larger than the given bytes, e.g., those which do not fit in the cache
+	 */
+	size_t tables(size_t above = 0) const {
+		size_t n = 0;
+		for (const weight& w : net) n += w.size() * sizeof(weight::type) > above;
+		return n;
+	}
+
+	void advise_hugepage() {
+		for (weight& w : net) w.advise_hugepage();
+	}
+
+	/**
+	 * use the tables of another player through views instead of copies
+	 * e.g., players on different threads evaluating (or training) the same network
+	 */
+	void share(player& other) {
+		net.clear();
+		for (weight& w : other.net) net.emplace_back(&w[0], w.size());
+	}
+
+	/**
+	 * copy the tables of another player into tables owned by this player
+	 */
+	void clone(const player& other) {
+		net.clear();
+		for (const weight& w : other.net) {
+			net.emplace_back(w.size());
+			std::copy(&w[0], &w[0] + w.size(), &net.back()[0]);
+		}
+	}
+
 	int extract_index(const board& after, int a, int b, int c, int d) {
 		return  MAX_INDEX * MAX_INDEX * MAX_INDEX * std::min((int)after(a), MAX_INDEX - 1) + 
 				MAX_INDEX * MAX_INDEX * std::min((int)after(b), MAX_INDEX - 1) + 
@@ -161,6 +250,8 @@ public:
 	}
 
 	virtual action take_action(const board& before) {
+		auto start = std::chrono::steady_clock::now();
+		bool swapped = watcher.joinable() && pin_model();
 		int best_op = -1;
 		int best_reward = -1;
 		float best_value = -std::numeric_limits<float>::max();
@@ -181,6 +272,7 @@ public:
 		if (best_op != -1) {
 			history.push_back({best_reward, best_after});
 		}
+		if (watcher.joinable()) record_query(start, swapped);
 		return action::slide(best_op);
 	}
 
@@ -260,21 +352,129 @@ protected:
 		net.emplace_back(MAX_INDEX * MAX_INDEX * MAX_INDEX * MAX_INDEX);
 	}
 	virtual void load_weights(const std::string& path) {
-		std::ifstream in(path, std::ios::in | std::ios::binary);
-		if (!in.is_open()) std::exit(-1);
-		uint32_t size;
+		if (!read_weights(path, net)) std::exit(-1);
+	}
+	/**
+	 * read a (possibly compressed) weight file
+	 * return false if the file cannot be opened or is truncated
+	 */
+	static bool read_weights(const std::string& path, std::vector<weight>& net) {
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file.is_open()) return false;
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		if (codec::is_packed(data)) data = codec::decompress(data);
+		std::stringstream in(data);
+		uint32_t size = 0;
 		in.read(reinterpret_cast<char*>(&size), sizeof(size));
 		net.resize(size);
 		for (weight& w : net) in >> w;
-		in.close();
+		return in && in.peek() == EOF;
+	}
+	virtual void embed_weights() {
+		if (!embedded_weights_begin || !embedded_weights_end) std::exit(-1);
+		if (codec::is_packed(std::string(embedded_weights_begin, std::min<size_t>(embedded_weights_end - embedded_weights_begin, 4)))) {
+			std::cerr << "embed: the linked weight file is compressed, save it without compress before make embed" << std::endl;
+			std::exit(-1);
+		}
+		if (!weight::view(embedded_weights_begin, embedded_weights_end, net)) std::exit(-1);
 	}
 	virtual void save_weights(const std::string& path) {
-		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
-		if (!out.is_open()) std::exit(-1);
+		std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) std::exit(-1);
+		std::stringstream out;
 		uint32_t size = net.size();
 		out.write(reinterpret_cast<char*>(&size), sizeof(size));
 		for (weight& w : net) out << w;
-		out.close();
+		if (meta.find("compress") != meta.end()) // pack the float tables with a 4-byte shuffle
+			file << codec::compress(out.str(), sizeof(weight::type));
+		else
+			file << out.rdbuf();
+		file.close();
+	}
+
+protected:
+	typedef std::vector<weight> model;
+
+	/**
+	 * serve the current tables through a published snapshot, and watch the
+	 * weight file in the background to publish new snapshots when it changes
+	 *
+	 * the query thread pins the latest snapshot at the beginning of each query
+	 * and works on views of it, while the watcher keeps the replaced snapshots
+	 * until a newer one is pinned, so that they are freed by the watcher rather
+	 * than by the query which swaps the tables
+	 */
+	void start_reload(const std::string& path) {
+		std::atomic_store(&published, std::make_shared<model>(std::move(net)));
+		version = 1;
+		pin_model();
+		watcher = std::thread([this, path]() {
+			struct stat st = {};
+			stat(path.c_str(), &st);
+			auto mtime = st.st_mtim;
+			auto size = st.st_size;
+			std::vector<std::pair<unsigned, std::shared_ptr<model>>> retired;
+			while (!stopped) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				while (retired.size() && retired.front().first < pinned_version.load()) // no longer pinned
+					retired.erase(retired.begin());
+				if (stat(path.c_str(), &st) != 0) continue;
+				if (st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec && st.st_size == size) continue;
+				auto start = std::chrono::steady_clock::now();
+				std::shared_ptr<model> next = std::make_shared<model>();
+				if (!read_weights(path, *next)) continue; // still being written, retry at the next poll
+				mtime = st.st_mtim;
+				size = st.st_size;
+				if (!same_shape(*next, *std::atomic_load(&published))) {
+					std::cout << "reload: " << path << " skipped, the tables do not match the current model" << std::endl;
+					continue;
+				}
+				reload_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				retired.emplace_back(version.load(), std::atomic_load(&published));
+				std::atomic_store(&published, next);
+				version++;
+			}
+		});
+	}
+
+	static bool same_shape(const model& a, const model& b) {
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++)
+			if (a[i].size() != b[i].size()) return false;
+		return true;
+	}
+
+	/**
+	 * pin the latest snapshot if a new one is published
+	 * return true if the tables are swapped
+	 */
+	bool pin_model() {
+		unsigned latest = version.load();
+		if (latest == pinned_version) return false;
+		pinned = std::atomic_load(&published);
+		pinned_version = latest;
+		net.clear();
+		for (weight& w : *pinned) net.emplace_back(&w[0], w.size());
+		return true;
+	}
+
+	/**
+	 * record the latency of a query, and report the reload at the query which swaps the tables
+	 */
+	void record_query(std::chrono::steady_clock::time_point start, bool swapped) {
+		uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		if (swapped && pinned_version > 1) {
+			std::cout << "reload: version " << pinned_version << ", load = " << (reload_time / 1000.0) << " ms, ";
+			std::cout << "swap query = " << (time / 1000.0) << " us, ";
+			std::cout << "queries = " << queries << " (avg = " << (queries ? query_time / 1000.0 / queries : 0) << " us, ";
+			std::cout << "max = " << (query_max / 1000.0) << " us) since the last swap" << std::endl;
+			queries = query_time = query_max = 0;
+			return;
+		}
+		queries++;
+		query_time += time;
+		query_max = std::max(query_max, time);
 	}
 
 protected:
@@ -286,6 +486,17 @@ protected:
 	};
 	std::vector<step> history;
 	int MAX_INDEX = 23;
+
+	std::shared_ptr<model> published; // accessed through std::atomic_load and std::atomic_store
+	std::atomic<unsigned> version;
+	std::shared_ptr<model> pinned;
+	std::atomic<unsigned> pinned_version;
+	std::thread watcher;
+	std::atomic<bool> stopped;
+	std::atomic<uint64_t> reload_time;
+	uint64_t queries;
+	uint64_t query_time;
+	uint64_t query_max;
 };
 
 /**
@@ -309,6 +520,14 @@ public:
 		return action();
 	}
 
+	virtual void notify(const std::string& msg) {
+		random_agent::notify(msg);
+		if (msg.find("seed=") == 0) { // restart the sequence from the initial order
+			std::sort(space.begin(), space.end());
+			popup.reset();
+		}
+	}
+
 private:
 	std::array<int, 16> space;
 	std::uniform_int_distribution<int> popup;
@@ -0,0 +1,186 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * campaign.h: Directory-based work queue for splitting episodes among workers
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <csignal>
+#include <ctime>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+/**
+ * work queue of episode ranges in a directory shared by the workers
+ *
+ * layout:
+ *  todo/<first>-<last>               ranges waiting to be claimed
+ *  doing/<first>-<last>@<host>.<pid> ranges claimed by a worker
+ *  done/<first>-<last>               results of finished ranges
+ *
+ * the directory is populated aside and renamed into place, ranges are claimed
+ * by renaming from todo to doing, and results are written aside and renamed
+ * into done, so a crashed worker only loses the range it was playing
+ *
+ * a claim is a lease, the worker touches its claim while playing, and a claim
+ * not touched for 'lease' seconds is returned to the queue by any worker
+ * (the clocks of the hosts are assumed to be roughly in sync)
+ */
+class campaign {
+public:
+	campaign(const std::string& dir, unsigned lease = 600) : dir(dir), lease(lease), renewed(0) {
+		char host[256] = {};
+		gethostname(host, sizeof(host) - 1);
+		owner = std::string(host) + "." + std::to_string(getpid());
+	}
+
+public:
+	/**
+	 * create the queue with 'total' episodes split into ranges of 'range' episodes
+	 * return false if the queue already exists (e.g., created by another worker)
+	 */
+	bool create(size_t total, size_t range) {
+		std::string tmp = dir + ".tmp." + owner;
+		mkdir(tmp.c_str(), 0755);
+		for (auto sub : { "/todo", "/doing", "/done" }) mkdir((tmp + sub).c_str(), 0755);
+		for (size_t first = 0; first < total; first += range) {
+			std::ofstream(tmp + "/todo/" + label(first, std::min(first + range, total)));
+		}
+		if (std::rename(tmp.c_str(), dir.c_str()) == 0) return true;
+		for (auto sub : { "/todo", "/doing", "/done" }) {
+			for (const std::string& name : list(tmp + sub)) unlink((tmp + sub + "/" + name).c_str());
+			rmdir((tmp + sub).c_str());
+		}
+		rmdir(tmp.c_str());
+		return false;
+	}
+
+	/**
+	 * claim a pending range [first, last)
+	 * return false if there is nothing left to claim
+	 */
+	bool claim(size_t& first, size_t& last) {
+		for (const std::string& name : list(dir + "/todo")) {
+			std::string from = dir + "/todo/" + name;
+			std::string to = dir + "/doing/" + name + "@" + owner;
+			if (utime(from.c_str(), nullptr) != 0) continue; // start the lease before the claim is visible
+			if (std::rename(from.c_str(), to.c_str()) != 0) continue; // claimed by another worker
+			renewed = std::time(nullptr);
+			return parse(name, first, last);
+		}
+		return false;
+	}
+
+	/**
+	 * renew the lease of a claimed range, the claim is touched at most every quarter of the lease
+	 */
+	void renew(size_t first, size_t last) {
+		std::time_t now = std::time(nullptr);
+		if (now - renewed < std::time_t(lease / 4)) return;
+		utime((dir + "/doing/" + label(first, last) + "@" + owner).c_str(), nullptr);
+		renewed = now;
+	}
+
+	/**
+	 * publish the result of a claimed range and release the claim
+	 * a range whose lease expired may be played twice, both results are the same
+	 */
+	void complete(size_t first, size_t last, const std::string& result) {
+		std::string name = label(first, last);
+		std::string tmp = dir + "/done/." + name + "@" + owner;
+		std::ofstream out(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+		out << result;
+		out.close();
+		if (!out) std::exit(-1);
+		std::rename(tmp.c_str(), (dir + "/done/" + name).c_str());
+		unlink((dir + "/doing/" + name + "@" + owner).c_str());
+	}
+
+	/**
+	 * return claimed ranges to the queue, i.e., the claims of dead workers on this host
+	 * and the claims of any host whose lease expired (never with lease = 0)
+	 */
+	size_t requeue() {
+		size_t count = 0;
+		std::string host = owner.substr(0, owner.rfind('.'));
+		std::time_t now = std::time(nullptr);
+		for (const std::string& name : list(dir + "/doing")) {
+			size_t at = name.find('@'), dot = name.rfind('.');
+			if (at == std::string::npos || dot == std::string::npos || dot < at) continue;
+			std::string from = dir + "/doing/" + name;
+			bool dead = false, expired = false;
+			if (name.substr(at + 1, dot - at - 1) == host) {
+				pid_t pid = std::stol(name.substr(dot + 1));
+				dead = kill(pid, 0) != 0 && errno == ESRCH;
+			}
+			struct stat st;
+			if (lease && stat(from.c_str(), &st) == 0) expired = now - st.st_mtime > std::time_t(lease);
+			if (!dead && !expired) continue;
+			std::string to = dir + "/todo/" + name.substr(0, at);
+			if (std::rename(from.c_str(), to.c_str()) == 0) count++;
+		}
+		return count;
+	}
+
+	/**
+	 * return the results of finished ranges in the order of episodes
+	 */
+	std::vector<std::string> results() const {
+		std::vector<std::string> res;
+		for (const std::string& name : list(dir + "/done")) {
+			if (name[0] == '.') continue;
+			std::ifstream in(dir + "/done/" + name, std::ios::in | std::ios::binary);
+			res.emplace_back((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		}
+		return res;
+	}
+
+	size_t pending() const { return list(dir + "/todo").size(); }
+	size_t running() const { return list(dir + "/doing").size(); }
+
+protected:
+	static std::string label(size_t first, size_t last) {
+		std::stringstream ss;
+		ss << std::setfill('0') << std::setw(12) << first << '-' << std::setw(12) << last;
+		return ss.str();
+	}
+	static bool parse(const std::string& name, size_t& first, size_t& last) {
+		std::stringstream ss(name);
+		char dash;
+		return bool(ss >> first >> dash >> last);
+	}
+	static std::vector<std::string> list(const std::string& path) {
+		std::vector<std::string> names;
+		DIR* dp = opendir(path.c_str());
+		if (!dp) return names;
+		for (dirent* ent; (ent = readdir(dp)) != nullptr; ) {
+			std::string name(ent->d_name);
+			if (name != "." && name != "..") names.push_back(name);
+		}
+		closedir(dp);
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+private:
+	std::string dir;
+	std::string owner;
+	unsigned lease;
+	std::time_t renewed;
+};
@@ -0,0 +1,245 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * codec.h: Dependency-free block compression for episode logs and weight files
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * block codec with an LZ77-style compressor
+ *
+ * the input is split into independent blocks, which are compressed in parallel
+ * and can be decompressed individually (random access by block)
+ *
+ * packed format (little-endian):
+ *  "TCGZ"          magic
+ *  uint32 stride   byte-shuffle stride, 4 for float tables, 1 for text
+ *  uint32 block    block size of the raw data
+ *  uint64 size     size of the raw data
+ *  uint64 offset[] offsets of blocks after the header, (n + 1) entries
+ *  blocks          each block starts with a mode byte, 0: stored, 1: compressed
+ */
+class codec {
+public:
+	/**
+	 * compress the raw data
+	 * stride should match the element size of the data (e.g., 4 for float tables)
+	 * threads = 0 selects the number of hardware threads
+	 */
+	static std::string compress(const std::string& raw, unsigned stride = 1, size_t block = 1 << 20, unsigned threads = 0) {
+		size_t n = (raw.size() + block - 1) / block;
+		std::vector<std::string> packed(n);
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i; (i = next++) < n; ) {
+				size_t len = std::min(block, raw.size() - i * block);
+				packed[i] = pack_block(raw.data() + i * block, len, stride);
+			}
+		};
+		if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+		threads = std::min<size_t>(threads, std::max<size_t>(n, 1));
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+		worker();
+		for (std::thread& th : pool) th.join();
+
+		std::string out(magic(), 4);
+		put<uint32_t>(out, stride);
+		put<uint32_t>(out, block);
+		put<uint64_t>(out, raw.size());
+		uint64_t offset = 0;
+		for (const std::string& blk : packed) put<uint64_t>(out, offset), offset += blk.size();
+		put<uint64_t>(out, offset);
+		for (const std::string& blk : packed) out += blk;
+		return out;
+	}
+
+	/**
+	 * decompress the packed data
+	 * return an empty string if the data is corrupted
+	 */
+	static std::string decompress(const std::string& packed) {
+		reader in(packed);
+		std::string raw;
+		if (!in) return raw;
+		raw.reserve(in.size());
+		for (size_t i = 0; i < in.blocks(); i++) {
+			std::string blk = in.block(i);
+			if (blk.empty()) return {};
+			raw += blk;
+		}
+		return raw;
+	}
+
+	/**
+	 * check whether the data is packed by this codec
+	 */
+	static bool is_packed(const std::string& data) {
+		return data.size() >= 4 && data.compare(0, 4, magic(), 4) == 0;
+	}
+
+	/**
+	 * random access to the blocks of packed data
+	 */
+	class reader {
+	public:
+		reader(const std::string& packed) : data(packed), stride(1), block_size(0), raw_size(0), header(0) {
+			if (!is_packed(data) || data.size() < 20) return;
+			stride = get<uint32_t>(data, 4);
+			block_size = get<uint32_t>(data, 8);
+			raw_size = get<uint64_t>(data, 12);
+			if (stride == 0 || block_size == 0) return;
+			uint64_t n = raw_size / block_size + (raw_size % block_size != 0);
+			if (n >= (data.size() - 20) / sizeof(uint64_t)) return; // the (n + 1) offsets do not fit in the data
+			header = 20 + (n + 1) * sizeof(uint64_t);
+			size_t payload = data.size() - header;
+			if (raw_size / max_match > payload) return; // no packed byte expands to more than max_match bytes
+			for (size_t i = 0; i <= n; i++) offset.push_back(get<uint64_t>(data, 20 + i * sizeof(uint64_t)));
+			bool valid = offset.front() == 0 && offset.back() == payload;
+			for (size_t i = 0; i < n && valid; i++) valid = offset[i] < offset[i + 1]; // each block has its mode byte
+			if (!valid) offset.clear();
+		}
+		operator bool() const { return offset.size(); }
+		size_t size() const { return raw_size; }
+		size_t blocks() const { return offset.size() ? offset.size() - 1 : 0; }
+
+		/**
+		 * return the raw data of the i-th block, or an empty string if it is corrupted
+		 */
+		std::string block(size_t i) const {
+			if (i >= blocks()) return {};
+			size_t len = std::min<size_t>(block_size, raw_size - i * block_size);
+			return unpack_block(data.data() + header + offset[i], offset[i + 1] - offset[i], len, stride);
+		}
+
+	private:
+		const std::string& data;
+		uint32_t stride;
+		uint32_t block_size;
+		uint64_t raw_size;
+		size_t header;
+		std::vector<uint64_t> offset;
+	};
+
+protected:
+	static constexpr unsigned hash_bits = 16;
+	static constexpr size_t min_match = 4;
+	static constexpr size_t max_match = 1 << 16;
+	static constexpr size_t max_offset = 1 << 24;
+
+	static const char* magic() { return "TCGZ"; }
+
+	template<typename type> static void put(std::string& out, type v) {
+		out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+	}
+	template<typename type> static type get(const std::string& in, size_t pos) {
+		type v;
+		std::memcpy(&v, in.data() + pos, sizeof(v));
+		return v;
+	}
+	static void put_varint(std::string& out, size_t v) {
+		for (; v >= 0x80; v >>= 7) out += char(v | 0x80);
+		out += char(v);
+	}
+	static bool get_varint(const uint8_t*& ptr, const uint8_t* end, size_t& v) {
+		v = 0;
+		for (unsigned shift = 0; ptr < end && shift < 64; shift += 7) {
+			uint8_t b = *(ptr++);
+			v |= size_t(b & 0x7f) << shift;
+			if ((b & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	/**
+	 * group the i-th bytes of all elements together, so that the similar
+	 * exponent and sign bytes of float tables form long repeated runs
+	 */
+	static std::string shuffle(const char* src, size_t len, unsigned stride) {
+		std::string out(len, 0);
+		size_t n = len / stride, k = 0;
+		for (unsigned b = 0; b < stride && n; b++)
+			for (size_t i = 0; i < n; i++) out[k++] = src[i * stride + b];
+		std::copy(src + n * stride, src + len, &out[k]);
+		return out;
+	}
+	static std::string unshuffle(const std::string& in, unsigned stride) {
+		std::string out(in.size(), 0);
+		size_t n = in.size() / stride, k = 0;
+		for (unsigned b = 0; b < stride && n; b++)
+			for (size_t i = 0; i < n; i++) out[i * stride + b] = in[k++];
+		std::copy(in.begin() + k, in.end(), &out[n * stride]);
+		return out;
+	}
+
+	/**
+	 * sequence format: varint(literal length), literals, varint(offset), varint(match length - min_match)
+	 * matches are limited to max_match bytes, which bounds the expansion of packed data
+	 * the last sequence has only literals
+	 */
+	static std::string pack_block(const char* src, size_t len, unsigned stride) {
+		std::string input = stride > 1 ? shuffle(src, len, stride) : std::string(src, len);
+		const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+		std::string out(1, char(1));
+		std::vector<uint32_t> table(1u << hash_bits, -1u);
+		size_t anchor = 0, pos = 0;
+		while (pos + min_match <= len) {
+			uint32_t seq;
+			std::memcpy(&seq, in + pos, sizeof(seq));
+			uint32_t& slot = table[(seq * 2654435761u) >> (32 - hash_bits)];
+			size_t cand = slot;
+			slot = pos;
+			if (cand == -1u || pos - cand > max_offset || std::memcmp(in + cand, in + pos, min_match) != 0) {
+				pos++;
+				continue;
+			}
+			size_t match = min_match;
+			while (pos + match < len && match < max_match && in[cand + match] == in[pos + match]) match++;
+			put_varint(out, pos - anchor);
+			out.append(input, anchor, pos - anchor);
+			put_varint(out, pos - cand);
+			put_varint(out, match - min_match);
+			pos += match;
+			anchor = pos;
+		}
+		put_varint(out, len - anchor);
+		out.append(input, anchor, len - anchor);
+		if (out.size() > len) { // incompressible, store the raw bytes instead
+			out.assign(1, char(0));
+			out.append(src, len);
+		}
+		return out;
+	}
+
+	static std::string unpack_block(const char* src, size_t size, size_t len, unsigned stride) {
+		const uint8_t* ptr = reinterpret_cast<const uint8_t*>(src);
+		const uint8_t* end = ptr + size;
+		if (ptr == end) return {};
+		if (*(ptr++) == 0) return size - 1 == len ? std::string(src + 1, len) : std::string();
+		std::string out;
+		out.reserve(len);
+		while (true) {
+			size_t lit, offset, match;
+			if (!get_varint(ptr, end, lit) || size_t(end - ptr) < lit || out.size() + lit > len) return {};
+			out.append(reinterpret_cast<const char*>(ptr), lit);
+			ptr += lit;
+			if (out.size() == len) break;
+			if (!get_varint(ptr, end, offset) || !get_varint(ptr, end, match)) return {};
+			match += min_match;
+			if (offset == 0 || offset > out.size() || match > max_match || out.size() + match > len) return {};
+			for (size_t i = out.size() - offset; match; match--) out += out[i++]; // the match may overlap itself
+		}
+		return stride > 1 ? unshuffle(out, stride) : out;
+	}
+};
@@ -24,9 +24,14 @@ class statistic;
 class episode {
 friend class statistic;
 public:
-	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) { ep_moves.reserve(10000); }
+	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) { ep_moves.reserve(max_moves); }
 
 public:
+	/**
+	 * the approximate memory footprint of an episode, including the reserved moves
+	 */
+	static size_t footprint() { return sizeof(episode) + max_moves * sizeof(move); }
+
 	board& state() { return ep_state; }
 	const board& state() const { return ep_state; }
 	board::reward score() const { return ep_score; }
@@ -121,6 +126,7 @@ public:
 	}
 
 protected:
+	static constexpr size_t max_moves = 10000;
 
 	struct move {
 		action code;
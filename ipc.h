@@ -0,0 +1,280 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * ipc.h: Shared-memory channel and agent adapter for agents in another local process
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+
+/**
+ * bidirectional message channel in a POSIX shared memory object
+ *
+ * each direction is a single-producer single-consumer ring buffer, the consumer
+ * spins for a short while and then sleeps on a futex until the producer wakes it
+ *
+ * the server (the peer hosting the agent) creates the object, and the client
+ * (the adapter in the game process) opens it; both processes record their pid
+ * in the object, so that a side waiting for a message notices a dead peer
+ */
+class channel {
+public:
+	enum : uint32_t { open = 1, close, take, check, notify, reply, quit };
+
+	/**
+	 * a cache-line sized message carrying a packed board and an action
+	 */
+	struct message {
+		uint32_t type;
+		uint32_t code;
+		uint8_t tile[16];
+		char text[40];
+
+		message(uint32_t type = 0, uint32_t code = 0, const std::string& str = "") : type(type), code(code), tile() {
+			std::memset(text, 0, sizeof(text));
+			str.copy(text, sizeof(text) - 1);
+		}
+		message(uint32_t type, const board& b) : message(type) { pack(b); }
+
+		void pack(const board& b) {
+			for (int i = 0; i < 16; i++) tile[i] = b(i);
+		}
+		board unpack() const {
+			board b;
+			for (int i = 0; i < 16; i++) b(i) = tile[i];
+			return b;
+		}
+	};
+
+public:
+	channel(const std::string& name, bool create) : name(name), server(create), shm(create ? host(name) : attach(name)) {
+		if (!shm) std::exit(-1);
+	}
+	~channel() {
+		munmap(shm, sizeof(layout));
+		if (server) shm_unlink(name.c_str());
+	}
+	channel(const channel&) = delete;
+	channel& operator =(const channel&) = delete;
+
+public:
+	/**
+	 * post a message, the message is dropped if the peer is gone
+	 */
+	void send(const message& msg) {
+		while (!outbox().push(msg)) if (!alive(peer())) return;
+	}
+	/**
+	 * wait for a message, a quit message is returned if the peer is gone
+	 */
+	message recv() {
+		message msg;
+		while (!inbox().pop(msg)) if (!alive(peer())) return message(quit);
+		return msg;
+	}
+
+protected:
+	static constexpr size_t depth = 64;
+	static std::chrono::milliseconds patience() { return std::chrono::milliseconds(100); } // before checking the peer
+
+	class ring {
+	public:
+		ring() : head(0), waiting(0), tail(0) {}
+
+		/**
+		 * return false if the ring stays full for the patience
+		 */
+		bool push(const message& msg) {
+			uint32_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) == depth) {
+				auto deadline = std::chrono::steady_clock::now() + patience();
+				while (h - tail.load(std::memory_order_acquire) == depth) {
+					if (std::chrono::steady_clock::now() > deadline) return false;
+					std::this_thread::yield();
+				}
+			}
+			slot[h % depth] = msg;
+			head.store(h + 1, std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_seq_cst)) // only the consumer clears it
+				futex(&head, FUTEX_WAKE, INT32_MAX);
+			return true;
+		}
+		/**
+		 * return false if the ring stays empty for the patience (or the sleep is interrupted)
+		 */
+		bool pop(message& msg) {
+			uint32_t t = tail.load(std::memory_order_relaxed);
+			for (unsigned spin = 0; head.load(std::memory_order_acquire) == t; spin++) {
+				if (spin < 4096) continue;
+				if (spin > 4096) return false;
+				struct timespec timeout = { 0, long(patience().count()) * 1000000 };
+				waiting.store(1, std::memory_order_seq_cst);
+				if (head.load(std::memory_order_seq_cst) == t) futex(&head, FUTEX_WAIT, t, &timeout);
+				waiting.store(0, std::memory_order_seq_cst);
+			}
+			msg = slot[t % depth];
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		static void futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* timeout = nullptr) {
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+		}
+
+		alignas(64) std::atomic<uint32_t> head;
+		std::atomic<uint32_t> waiting;
+		alignas(64) std::atomic<uint32_t> tail;
+		alignas(64) message slot[depth];
+	};
+
+	struct layout {
+		static constexpr uint32_t magic = 0x32353834; // "2584"
+		std::atomic<uint32_t> ready;
+		std::atomic<pid_t> server;
+		std::atomic<pid_t> client;
+		ring request;  // client -> server
+		ring response; // server -> client
+		layout() : ready(0), server(0), client(0) {}
+	};
+
+	ring& inbox() { return server ? shm->request : shm->response; }
+	ring& outbox() { return server ? shm->response : shm->request; }
+
+	/**
+	 * create a new object, the object left by a crashed server is unlinked first,
+	 * so that a client still mapping it is not affected
+	 */
+	static layout* host(const std::string& name) {
+		shm_unlink(name.c_str());
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd == -1) return nullptr;
+		void* ptr = ftruncate(fd, sizeof(layout)) == 0 ? map(fd) : nullptr;
+		::close(fd);
+		if (!ptr) return nullptr;
+		layout* shm = new (ptr) layout();
+		shm->server.store(getpid());
+		shm->ready.store(layout::magic);
+		return shm;
+	}
+
+	/**
+	 * open the object of a running server, waiting up to 10 seconds for it to be created
+	 */
+	static layout* attach(const std::string& name) {
+		for (int retry = 0; retry < 1000; retry++) {
+			int fd = shm_open(name.c_str(), O_RDWR, 0600);
+			struct stat st;
+			void* ptr = fd != -1 && fstat(fd, &st) == 0 && size_t(st.st_size) == sizeof(layout) ? map(fd) : nullptr;
+			if (fd != -1) ::close(fd);
+			layout* shm = static_cast<layout*>(ptr);
+			if (shm && shm->ready.load() == layout::magic && alive(shm->server.load())) {
+				shm->client.store(getpid());
+				return shm;
+			}
+			if (shm) munmap(shm, sizeof(layout)); // not ready yet, or left by a crashed server
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return nullptr;
+	}
+
+	static void* map(int fd) {
+		void* ptr = mmap(nullptr, sizeof(layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		return ptr != MAP_FAILED ? ptr : nullptr;
+	}
+
+	/**
+	 * check whether a process is alive, pid 0 is a client which has not attached yet
+	 */
+	static bool alive(pid_t pid) {
+		return pid == 0 || kill(pid, 0) == 0 || errno != ESRCH;
+	}
+	pid_t peer() const { return server ? shm->client.load() : shm->server.load(); }
+
+private:
+	std::string name;
+	bool server;
+	layout* shm;
+};
+
+/**
+ * adapter for an agent served by another local process through a channel
+ * the peer is selected by 'shm', e.g., shm=/tcg2584
+ *
+ * episode events and notifications are posted without waiting, while
+ * take_action and check_for_win wait for the reply of the peer
+ */
+class shm_agent : public agent {
+public:
+	shm_agent(const std::string& args = "") : agent("name=remote role=environment " + args),
+		link(property("shm"), false), calls(0), elapsed(0) {}
+	virtual ~shm_agent() {
+		link.send(channel::message(channel::quit));
+		if (calls) {
+			std::cout << name() << ": " << calls << " round trips, avg = ";
+			std::cout << (elapsed / 1000.0 / calls) << " us" << std::endl;
+		}
+	}
+
+	virtual void open_episode(const std::string& flag = "") {
+		link.send(channel::message(channel::open, 0, flag));
+	}
+	virtual void close_episode(const std::string& flag = "") {
+		link.send(channel::message(channel::close, 0, flag));
+	}
+	virtual action take_action(const board& b) {
+		auto start = std::chrono::steady_clock::now();
+		link.send(channel::message(channel::take, b));
+		channel::message msg = reply();
+		elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		calls++;
+		return action(msg.code);
+	}
+	virtual bool check_for_win(const board& b) {
+		link.send(channel::message(channel::check, b));
+		return reply().code;
+	}
+	virtual void notify(const std::string& msg) {
+		agent::notify(msg);
+		link.send(channel::message(channel::notify, 0, msg));
+	}
+
+protected:
+	/**
+	 * wait for the reply of the peer, the game cannot go on without it
+	 */
+	channel::message reply() {
+		channel::message msg = link.recv();
+		if (msg.type == channel::reply) return msg;
+		std::cerr << name() << ": the peer at " << property("shm") << " is gone" << std::endl;
+		std::exit(-1);
+	}
+
+private:
+	channel link;
+	size_t calls;
+	uint64_t elapsed;
+};
@@ -0,0 +1,191 @@
+/**
+ * Framework for 2048 & 2048-like Games (C++ 11)
+ * resource.h: Probe the machine and plan threads and memory accordingly
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <sched.h>
+#include <dirent.h>
+
+/**
+ * machine resources visible to this process
+ *
+ * the CPU topology, caches, and NUMA nodes are read from /sys/devices/system, the cgroup
+ * limits from /sys/fs/cgroup (both v1 and v2), and the memory from /proc/meminfo
+ */
+class resource {
+public:
+	resource() : cpus(1), cores(1), nodes(1), cache(0), quota(0), memory(0), available(0) {
+		cpu_set_t mask;
+		CPU_ZERO(&mask); // no topology is read if the mask is not available
+		if (sched_getaffinity(0, sizeof(mask), &mask) == 0) cpus = std::max(CPU_COUNT(&mask), 1);
+		std::set<std::pair<std::string, std::string>> core;
+		for (int i = 0; i < CPU_SETSIZE; i++) {
+			if (!CPU_ISSET(i, &mask)) continue;
+			std::string topo = "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/topology/";
+			core.emplace(read(topo + "physical_package_id"), read(topo + "core_id"));
+		}
+		cores = std::max<size_t>(core.size(), 1);
+		nodes = std::max<size_t>(count("/sys/devices/system/node", "node"), 1);
+		for (int i = 0, last = 0; ; i++) { // the size of the last-level cache
+			std::string index = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + "/";
+			std::string level = read(index + "level"), size = read(index + "size");
+			if (level.empty() || size.empty() || !std::isdigit(size[0])) break;
+			if (std::stoi(level) < last) continue;
+			last = std::stoi(level);
+			cache = std::stoull(size) << (size.back() == 'M' ? 20 : size.back() == 'K' ? 10 : 0);
+		}
+
+		std::map<std::string, std::string> group = cgroups();
+		std::stringstream v2(read(cgroup_path("/sys/fs/cgroup", group[""], "cpu.max")));
+		std::string max;
+		double period = 0;
+		if (v2 >> max >> period && max != "max" && period > 0) quota = std::stod(max) / period;
+		double v1 = std::stod("0" + read(cgroup_path("/sys/fs/cgroup/cpu", group["cpu"], "cpu.cfs_quota_us")));
+		period = std::stod("0" + read(cgroup_path("/sys/fs/cgroup/cpu", group["cpu"], "cpu.cfs_period_us")));
+		if (v1 > 0 && period > 0) quota = v1 / period;
+
+		std::stringstream meminfo(read("/proc/meminfo", "\n"));
+		for (std::string key; meminfo >> key; ) {
+			uint64_t kb = 0;
+			meminfo >> kb;
+			if (key == "MemTotal:") memory = kb << 10;
+			if (key == "MemAvailable:") available = kb << 10;
+			meminfo.ignore(64, '\n');
+		}
+		if (available == 0) available = memory;
+		for (std::string path : { cgroup_path("/sys/fs/cgroup", group[""], "memory.max"),
+			cgroup_path("/sys/fs/cgroup/memory", group["memory"], "memory.limit_in_bytes") }) {
+			std::string limit = read(path);
+			if (limit.empty() || !std::isdigit(limit[0])) continue;
+			memory = std::min<uint64_t>(memory, std::stoull(limit));
+			available = std::min(available, memory);
+		}
+		hugepage = read("/sys/kernel/mm/transparent_hugepage/enabled", "\n");
+	}
+
+public:
+	/**
+	 * the number of CPUs this process may use, limited by the affinity mask and the cgroup quota
+	 */
+	unsigned threads() const {
+		double limit = quota > 0 ? std::max(quota, 1.0) : cpus;
+		return std::max(1u, unsigned(std::min<double>(cpus, limit)));
+	}
+
+	/**
+	 * the transparent huge page mode, i.e., "always", "madvise", or "never"
+	 */
+	std::string hugepage_mode() const {
+		size_t lb = hugepage.find('['), rb = hugepage.find(']');
+		return lb < rb && rb != std::string::npos ? hugepage.substr(lb + 1, rb - lb - 1) : "never";
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const resource& res) {
+		out << "cpus = " << res.cpus << " (" << res.cores << " cores, " << res.nodes << " nodes), ";
+		out << "cache = " << (res.cache >> 10) << "K, ";
+		out << "quota = " << (res.quota > 0 ? std::to_string(res.quota) : "none") << ", ";
+		out << "memory = " << (res.memory >> 20) << "M (" << (res.available >> 20) << "M available), ";
+		out << "hugepage = " << res.hugepage_mode();
+		return out;
+	}
+
+public:
+	size_t cpus;
+	size_t cores;
+	size_t nodes;
+	uint64_t cache;
+	double quota;
+	uint64_t memory;
+	uint64_t available;
+	std::string hugepage;
+
+protected:
+	static std::string read(const std::string& path, const char* delim = "") {
+		std::ifstream in(path);
+		std::string line, all;
+		while (std::getline(in, line)) all += line + delim;
+		return all;
+	}
+	static size_t count(const std::string& path, const std::string& prefix) {
+		size_t n = 0;
+		DIR* dp = opendir(path.c_str());
+		if (!dp) return n;
+		for (dirent* ent; (ent = readdir(dp)) != nullptr; ) {
+			std::string name(ent->d_name);
+			if (name.find(prefix) == 0 && name.size() > prefix.size() && std::isdigit(name[prefix.size()])) n++;
+		}
+		closedir(dp);
+		return n;
+	}
+
+	/**
+	 * the cgroup of this process for each controller, "" for the unified (v2) hierarchy
+	 */
+	static std::map<std::string, std::string> cgroups() {
+		std::map<std::string, std::string> group;
+		std::stringstream in(read("/proc/self/cgroup", "\n"));
+		for (std::string line; std::getline(in, line); ) {
+			size_t a = line.find(':'), b = line.find(':', a + 1);
+			if (a == std::string::npos || b == std::string::npos) continue;
+			std::stringstream ctrl(line.substr(a + 1, b - a - 1));
+			std::string path = line.substr(b + 1);
+			if (ctrl.peek() == EOF) group[""] = path;
+			for (std::string name; std::getline(ctrl, name, ','); ) group[name] = path;
+		}
+		return group;
+	}
+
+	/**
+	 * the file of the cgroup of this process, or the root one if it is not visible
+	 */
+	static std::string cgroup_path(const std::string& mount, const std::string& group, const std::string& file) {
+		std::string path = mount + (group == "/" ? "" : group) + "/" + file;
+		return std::ifstream(path).good() ? path : mount + "/" + file;
+	}
+};
+
+/**
+ * configuration derived from the resources, flags given explicitly take precedence
+ */
+struct plan {
+	unsigned threads;  // worker threads (e.g., for compression)
+	size_t limit;      // episodes kept in memory by the statistic
+	bool hugepage;     // advise huge pages for the weight tables, collapsed by the kernel in the background
+	bool replicate;    // advisory only, replicating the weight tables on each NUMA node would help
+
+	/**
+	 * size the plan for 'total' episodes, with 'footprint' bytes per episode
+	 * and 'tables' bytes of weight tables
+	 */
+	plan(const resource& res, size_t total, size_t footprint, size_t tables) {
+		threads = res.threads();
+		uint64_t budget = res.available / 2; // leave room for the system and other processes
+		uint64_t space = budget > tables ? budget - tables : 0;
+		limit = std::max<size_t>(1, std::min<uint64_t>(total, space / std::max<size_t>(footprint, 1)));
+		std::string mode = res.hugepage_mode();
+		hugepage = mode == "madvise" && tables >= (2 << 20); // "always" needs no advice
+		replicate = res.nodes > 1 && threads > res.cores / res.nodes && tables * res.nodes < budget;
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const plan& p) {
+		out << "threads = " << p.threads << ", limit = " << p.limit << ", ";
+		out << "hugepage = " << (p.hugepage ? "advised" : "off") << ", "; // not immediate, the tables are in use
+		out << "replicate = " << (p.replicate ? "suggested" : "no"); // not applied, the tables are shared
+		return out;
+	}
+};
@@ -11,28 +11,58 @@
 #include <iostream>
 #include <vector>
 #include <utility>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
 
 class weight {
 public:
 	typedef float type;
 
 public:
-	weight() {}
-	weight(size_t len) : value(len) {}
-	weight(weight&& f) : value(std::move(f.value)) {}
-	weight(const weight& f) = default;
+	weight() : base(nullptr), length(0) {}
+	weight(size_t len) : value(len), base(value.data()), length(len) {}
+	weight(weight&& f) : value(std::move(f.value)), base(f.base), length(f.length) {
+		f.base = nullptr;
+		f.length = 0;
+	}
+	weight(const weight& f) : value(f.value), base(f.owned() ? value.data() : f.base), length(f.length) {}
+
+	/**
+	 * create a read-only view of an external table (e.g., an embedded or mapped model)
+	 * the memory is not owned and must outlive the view
+	 */
+	weight(const type* view, size_t len) : base(const_cast<type*>(view)), length(len) {}
+
+	weight& operator =(const weight& f) {
+		value = f.value;
+		base = f.owned() ? value.data() : f.base;
+		length = f.length;
+		return *this;
+	}
+	type& operator[] (size_t i) { return base[i]; }
+	const type& operator[] (size_t i) const { return base[i]; }
+	size_t size() const { return length; }
+	bool owned() const { return base == value.data(); }
 
-	weight& operator =(const weight& f) = default;
-	type& operator[] (size_t i) { return value[i]; }
-	const type& operator[] (size_t i) const { return value[i]; }
-	size_t size() const { return value.size(); }
+	/**
+	 * advise the kernel to back the owned table with transparent huge pages
+	 * the table is already in use, so it keeps small pages until khugepaged
+	 * collapses them in the background, i.e., the advice is not immediate
+	 */
+	void advise_hugepage() {
+		const uintptr_t align = 2 << 20;
+		if (!owned() || length == 0) return;
+		uintptr_t begin = (reinterpret_cast<uintptr_t>(base) + align - 1) & ~(align - 1);
+		uintptr_t end = reinterpret_cast<uintptr_t>(base + length) & ~(align - 1);
+		if (begin < end) madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);
+	}
 
 public:
 	friend std::ostream& operator <<(std::ostream& out, const weight& w) {
-		auto& value = w.value;
-		uint64_t size = value.size();
+		uint64_t size = w.length;
 		out.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
-		out.write(reinterpret_cast<const char*>(value.data()), sizeof(type) * size);
+		out.write(reinterpret_cast<const char*>(w.base), sizeof(type) * size);
 		return out;
 	}
 	friend std::istream& operator >>(std::istream& in, weight& w) {
@@ -41,9 +71,36 @@ public:
 		in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
 		value.resize(size);
 		in.read(reinterpret_cast<char*>(value.data()), sizeof(type) * size);
+		w.base = value.data();
+		w.length = size;
 		return in;
 	}
 
+	/**
+	 * build views of all tables stored in a serialized network (the format of weights.bin)
+	 * return the number of bytes consumed, or 0 if the buffer is truncated
+	 */
+	static size_t view(const char* begin, const char* end, std::vector<weight>& net) {
+		const char* ptr = begin;
+		uint32_t count = 0;
+		if (size_t(end - ptr) < sizeof(count)) return 0;
+		std::memcpy(&count, ptr, sizeof(count));
+		ptr += sizeof(count);
+		net.clear();
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t size = 0;
+			if (size_t(end - ptr) < sizeof(size)) return 0;
+			std::memcpy(&size, ptr, sizeof(size));
+			ptr += sizeof(size);
+			if (size_t(end - ptr) / sizeof(type) < size) return 0;
+			net.emplace_back(reinterpret_cast<const type*>(ptr), size);
+			ptr += sizeof(type) * size;
+		}
+		return ptr - begin;
+	}
+
 protected:
 	std::vector<type> value;
+	type* base;
+	size_t length;
 };